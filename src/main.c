@@ -49,6 +49,29 @@ struct metadata_cache *get_metacache() {
      return cache;
  }
 
+// parse fetch targets like "topic_a:0:100,topic_a:1,topic_b", partition and
+// offset were optional, means all partitions and the newest offset.
+static struct fetch_target *parse_fetch_targets(const char *spec, int *count) {
+    int i, n, field_count;
+    char **items, **fields;
+    struct fetch_target *targets;
+
+    items = split_string(spec, strlen(spec), ",", 1, &n);
+    if (!items) return NULL;
+    targets = malloc((n > 0 ? n : 1) * sizeof(*targets));
+    for (i = 0; i < n; i++) {
+        fields = split_string(items[i], strlen(items[i]), ":", 1, &field_count);
+        targets[i].topic = strdup(fields[0]);
+        targets[i].part_id = field_count > 1 ? atoi(fields[1]) : -1;
+        targets[i].offset = field_count > 2 ? atoll(fields[2]) : -1;
+        targets[i].leader_id = -1;
+        free_split_res(fields, field_count);
+    }
+    free_split_res(items, n);
+    *count = n;
+    return targets;
+}
+
 static void usage(const char *prog_name) {
     fprintf(stderr, "Usage: %s\n", prog_name);
     fprintf(stderr, "\t-b broker list, like localhost:9092.\n");
@@ -56,6 +79,10 @@ static void usage(const char *prog_name) {
     fprintf(stderr, "\t-T offsets timestamp, -1 = LATEST, -2 = EARLIEST.\n");
     fprintf(stderr, "\t-c client id.\n");
     fprintf(stderr, "\t-C consumer mode.\n");
+    fprintf(stderr, "\t-M multi consumer mode, fetch topic:partition:offset list, like t1:0:100,t1:1,t2.\n");
+    fprintf(stderr, "\t-F follow mode, keep consuming new messages until interrupted.\n");
+    fprintf(stderr, "\t-w consumer max wait time(ms) for fetch request.\n");
+    fprintf(stderr, "\t-n consumer min bytes for fetch request.\n");
     fprintf(stderr, "\t-p partition id.\n");
     fprintf(stderr, "\t-P producer mode.\n");
     fprintf(stderr, "\t-o consumer offset.\n");
@@ -73,25 +100,38 @@ void sig_handler(int signo)
     signal(SIGPIPE, SIG_IGN);
 }
 
+void sigint_handler(int signo)
+{
+    stop_follow_fetch();
+}
+
 int main(int argc, char **argv) {
     int ch, part_id = 0, offset = -1;
     int is_topic_list = 0, is_consumer = 0, is_producer = 0, is_offsets = 0;
+    int is_follow = 0, max_wait = -1, min_bytes = -1;
+    int i, target_count = 0, resp_count = 0;
     int fetch_size = 0, show_usage = 0;
     int ts = -1;
     char *topic = NULL, *key = NULL, *value = NULL, *type;
     char *brokers = NULL;
     char *client_id = NULL;
     char *log_level = NULL;
-    struct response *r;
+    char *fetch_targets = NULL;
+    struct fetch_target *targets = NULL;
+    struct response *r, **resps;
 
     srand(time(0));
-    while((ch = getopt(argc, argv, "b:t:T:c:Cp:Po:Of:k:v:l:Lh")) != -1) {
+    while((ch = getopt(argc, argv, "b:t:T:c:CM:Fw:n:p:Po:Of:k:v:l:Lh")) != -1) {
         switch(ch) {
             case 'b': brokers = strdup(optarg); break;
             case 't': topic = strdup(optarg); break;
             case 'T': ts = atoi(optarg); break;
             case 'c': client_id = strdup(optarg); break;
             case 'C': is_consumer = 1; break;
+            case 'M': fetch_targets = strdup(optarg); break;
+            case 'F': is_follow = 1; break;
+            case 'w': max_wait = atoi(optarg); break;
+            case 'n': min_bytes = atoi(optarg); break;
             case 'P': is_producer = 1; break;
             case 'p': part_id = atoi(optarg); break;
             case 'o': offset = atoi(optarg); break;
@@ -112,7 +152,7 @@ int main(int argc, char **argv) {
     if (!brokers) {
         logger(ERROR, "You shoud use -b to assign broker list.\n");
     }
-    if(!topic && !is_topic_list) {
+    if(!topic && !is_topic_list && !fetch_targets) {
         logger(ERROR, "You shoud use -t to assign topic.\n");
     }
     if (is_producer && !value) {
@@ -123,6 +163,8 @@ int main(int argc, char **argv) {
     }
 
     init_conf(client_id, brokers);
+    if (max_wait >= 0) conf->max_wait = max_wait;
+    if (min_bytes >= 0) conf->min_bytes = min_bytes;
     cache = alloc_metadata_cache();
     set_log_level(INFO);
     if (log_level) {
@@ -131,10 +173,28 @@ int main(int argc, char **argv) {
     if (signal(SIGPIPE, sig_handler) == SIG_ERR) {
         logger(ERROR, "can't catch SIGPIPE.");
     }
+    if (is_follow && signal(SIGINT, sigint_handler) == SIG_ERR) {
+        logger(ERROR, "can't catch SIGINT.");
+    }
     if (fetch_size <= 0) fetch_size = 1024;
 
     TIME_START();
-    if (is_consumer) {
+    if (fetch_targets) {
+        targets = parse_fetch_targets(fetch_targets, &target_count);
+        resps = send_multi_fetch_request(targets, target_count, fetch_size, &resp_count);
+        if (resp_count == 0) dump_fetch_response(NULL);
+        for (i = 0; i < resp_count; i++) {
+            dump_fetch_response(resps[i]);
+            dealloc_response(resps[i], FETCH_KEY);
+        }
+        free(resps);
+        for (i = 0; i < target_count; i++) free(targets[i].topic);
+        free(targets);
+        type = "multi_consumer";
+    } else if (is_follow) {
+        follow_fetch(topic, part_id, offset, fetch_size);
+        type = "follow";
+    } else if (is_consumer) {
         r = send_fetch_request(topic, part_id, offset, fetch_size);
         dump_fetch_response(r);
         dealloc_response(r, FETCH_KEY);
@@ -164,6 +224,7 @@ int main(int argc, char **argv) {
     if (key) free(key);
     if (value) free(value);
     if (log_level) free(log_level);
+    if (fetch_targets) free(fetch_targets);
 
     deinit_conf();
     dealloc_metadata_cache(cache);
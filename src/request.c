@@ -2,7 +2,8 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
- #include <unistd.h>
+#include <signal.h>
+#include <unistd.h>
 #include "buffer.h"
 #include "util.h"
 #include "request.h"
@@ -11,7 +12,11 @@
 #include "main.h"
 #include "conn.h"
 
+#define FOLLOW_RETRY_BACKOFF 100 /* ms */
+#define FOLLOW_MAX_FETCH_SIZE (64 * 1024 * 1024)
+
 static int32_t corr_id = 1001;
+static volatile sig_atomic_t follow_stopped = 0;
 
 static void rewrite_request_size(struct buffer *req_buf, int req_size) {
     char buf[4];
@@ -111,13 +116,10 @@ struct topic_metadata *get_topic_metadata(const char *topic) {
     return t_meta;
 }
 
-static int connect_leader_broker(const char *topic, int part_id) {
-    int i, leader_id = -1, rc;
+static int get_partition_leader(const char *topic, int part_id) {
+    int i, leader_id = -1;
     struct topic_metadata *t_meta;
-    struct broker_metadata *b_meta;
-    struct metadata_cache *cache;
 
-    cache = get_metacache();
     // get topic-partition leader info from cache or metadata request.
     TIME_START();
     t_meta = get_topic_metadata(topic);
@@ -136,7 +138,14 @@ static int connect_leader_broker(const char *topic, int part_id) {
         logger(DEBUG, "leader id not found."); 
         return K_ERR;
     }
-    b_meta = get_broker_metadata(cache, leader_id);
+    return leader_id;
+}
+
+static int connect_broker(int broker_id) {
+    int rc;
+    struct broker_metadata *b_meta;
+
+    b_meta = get_broker_metadata(get_metacache(), broker_id);
     if (!b_meta) {
         logger(DEBUG, "broker metadata not found."); 
         return K_ERR;
@@ -149,6 +158,14 @@ static int connect_leader_broker(const char *topic, int part_id) {
     return rc;
 }
 
+static int connect_leader_broker(const char *topic, int part_id) {
+    int leader_id;
+
+    leader_id = get_partition_leader(topic, part_id);
+    if (leader_id < 0) return K_ERR;
+    return connect_broker(leader_id);
+}
+
 static int random_connect_broker() {
     int port, rand_idx = 0, host_len, ret;
     char *ipport, *host, *p;
@@ -255,7 +272,7 @@ int64_t get_newest_offset(const char *topic, int part_id) {
             continue;
         }
         for (j = 0; j < t_info->part_count; j++) {
-            p_info = &t_info->p_infos[j];
+            p_info = &TYPE_CONVERT(struct offsets_part_info*, t_info->p_infos)[j];
             if (p_info && p_info->part_id == part_id && p_info->offset_count > 0) {
                 ret = p_info->offsets[0] - 1;
                 goto RET;
@@ -340,16 +357,9 @@ cleanup:
     return r;
 }
 
-struct response *send_fetch_request(const char *topic, int part_id, int64_t offset, int fetch_size) {
-    int cfd;
+static struct buffer *gen_fetch_request(const char *topic, int part_id, int64_t offset, int fetch_size) {
     struct client_config *conf;
-    struct buffer *req, *resp_buf;
-    struct response *r = NULL;
-
-    // connect to leader
-    cfd = connect_leader_broker(topic, part_id);
-    if (cfd <= 0) return NULL;
-    if (offset < 0) offset = get_newest_offset(topic, part_id);
+    struct buffer *req;
 
     conf = get_conf();
     req = alloc_request_buffer(FETCH_KEY); // request key
@@ -362,14 +372,213 @@ struct response *send_fetch_request(const char *topic, int part_id, int64_t offs
     write_int32_buffer(req, part_id); // partition id
     write_int64_buffer(req, offset); // offset
     write_int32_buffer(req, fetch_size); // fetch siz3
+    return req;
+}
 
+// send fetch request on the connected socket, and the socket wouldn't be closed.
+static struct response *fetch_on_conn(int cfd, const char *topic, int part_id, int64_t offset, int fetch_size) {
+    struct buffer *req, *resp_buf;
+    struct response *r = NULL;
+
+    req = gen_fetch_request(topic, part_id, offset, fetch_size);
     if(send_request(cfd, req) != K_OK) goto cleanup;
     resp_buf = wait_response(cfd);
+    if (!resp_buf) goto cleanup;
     r = parse_response(resp_buf, FETCH_KEY);
     dealloc_buffer(resp_buf);
 
 cleanup:
-    close(cfd);
     dealloc_buffer(req);
     return r;
 }
+
+struct response *send_fetch_request(const char *topic, int part_id, int64_t offset, int fetch_size) {
+    int cfd;
+    struct response *r;
+
+    // connect to leader
+    cfd = connect_leader_broker(topic, part_id);
+    if (cfd <= 0) return NULL;
+    if (offset < 0) offset = get_newest_offset(topic, part_id);
+
+    r = fetch_on_conn(cfd, topic, part_id, offset, fetch_size);
+    close(cfd);
+    return r;
+}
+
+static int compare_fetch_target(const void *a, const void *b) {
+    int rc;
+    const struct fetch_target *ta = a, *tb = b;
+
+    if (ta->leader_id != tb->leader_id) return ta->leader_id - tb->leader_id;
+    if ((rc = strcmp(ta->topic, tb->topic)) != 0) return rc;
+    return ta->part_id - tb->part_id;
+}
+
+// expand the targets which part_id < 0 to all partitions of the topic,
+// and resolve the leader of every target, return the new target array.
+static struct fetch_target *resolve_fetch_targets(struct fetch_target *targets, int count, int *new_count) {
+    int i, j, n = 0, cap;
+    struct topic_metadata *t_meta;
+    struct fetch_target *res, *t;
+
+    cap = count > 0 ? count : 1;
+    res = malloc(cap * sizeof(*res));
+    for (i = 0; i < count; i++) {
+        t_meta = get_topic_metadata(targets[i].topic);
+        if (!t_meta) {
+            logger(WARN, "topic %s metadata not found, skip it.", targets[i].topic);
+            continue;
+        }
+        for (j = 0; j < t_meta->partitions; j++) {
+            if (targets[i].part_id >= 0 && t_meta->part_metas[j]->part_id != targets[i].part_id) continue;
+            if (n == cap) {
+                cap *= 2;
+                res = realloc(res, cap * sizeof(*res));
+            }
+            t = &res[n++];
+            t->topic = targets[i].topic;
+            t->part_id = t_meta->part_metas[j]->part_id;
+            t->offset = targets[i].offset;
+            t->leader_id = t_meta->part_metas[j]->leader_id;
+            if (t->leader_id < 0) {
+                logger(WARN, "topic %s partition %d has no leader, skip it.", t->topic, t->part_id);
+                n--;
+            }
+        }
+    }
+    *new_count = n;
+    return res;
+}
+
+static struct buffer *gen_multi_fetch_request(struct fetch_target *targets, int count, int fetch_size) {
+    int i, j, topic_count = 0, part_count;
+    struct client_config *conf;
+    struct buffer *req;
+
+    // targets were sorted, so partitions of the same topic are adjacent
+    for (i = 0; i < count; i++) {
+        if (i == 0 || strcmp(targets[i].topic, targets[i-1].topic)) topic_count++;
+    }
+
+    conf = get_conf();
+    req = alloc_request_buffer(FETCH_KEY); // request key
+    write_int32_buffer(req, -1); // replica id
+    write_int32_buffer(req, conf->max_wait); // max wait
+    write_int32_buffer(req, conf->min_bytes); // min bytes
+    write_int32_buffer(req, topic_count); // topic count
+    for (i = 0; i < count; i += part_count) {
+        for (part_count = 1; i + part_count < count; part_count++) {
+            if (strcmp(targets[i].topic, targets[i + part_count].topic)) break;
+        }
+        write_short_string_buffer(req, targets[i].topic, strlen(targets[i].topic)); // topic
+        write_int32_buffer(req, part_count); // partition count
+        for (j = i; j < i + part_count; j++) {
+            write_int32_buffer(req, targets[j].part_id); // partition id
+            write_int64_buffer(req, targets[j].offset); // offset
+            write_int32_buffer(req, fetch_size); // fetch size
+        }
+    }
+    return req;
+}
+
+struct response **send_multi_fetch_request(struct fetch_target *targets, int count,
+        int fetch_size, int *resp_count) {
+    int i, n, cfd, group_start, group_size, nresp = 0;
+    struct fetch_target *resolved;
+    struct buffer *req, *resp_buf;
+    struct response **resps;
+
+    *resp_count = 0;
+    resolved = resolve_fetch_targets(targets, count, &n);
+    if (n <= 0) {
+        free(resolved);
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        if (resolved[i].offset < 0) {
+            resolved[i].offset = get_newest_offset(resolved[i].topic, resolved[i].part_id);
+        }
+    }
+    // group targets by leader, and one fetch request per leader
+    qsort(resolved, n, sizeof(*resolved), compare_fetch_target);
+    resps = calloc(n, sizeof(*resps));
+    for (group_start = 0; group_start < n; group_start += group_size) {
+        for (group_size = 1; group_start + group_size < n; group_size++) {
+            if (resolved[group_start + group_size].leader_id != resolved[group_start].leader_id) break;
+        }
+        cfd = connect_broker(resolved[group_start].leader_id);
+        if (cfd <= 0) continue;
+        logger(DEBUG, "fetch %d partitions from broker %d.", group_size, resolved[group_start].leader_id);
+        req = gen_multi_fetch_request(&resolved[group_start], group_size, fetch_size);
+        if (send_request(cfd, req) == K_OK && (resp_buf = wait_response(cfd)) != NULL) {
+            resps[nresp] = parse_response(resp_buf, FETCH_KEY);
+            if (resps[nresp]) nresp++;
+            dealloc_buffer(resp_buf);
+        }
+        dealloc_buffer(req);
+        close(cfd);
+    }
+
+    free(resolved);
+    *resp_count = nresp;
+    return resps;
+}
+
+void stop_follow_fetch() {
+    follow_stopped = 1;
+}
+
+int follow_fetch(const char *topic, int part_id, int64_t offset, int fetch_size) {
+    int cfd = -1, err_code;
+    struct response *r;
+    struct fetch_part_info *p_info;
+    struct messageset *msg_set;
+
+    if (offset < 0) offset = get_newest_offset(topic, part_id);
+    while (!follow_stopped) {
+        if (cfd <= 0) {
+            cfd = connect_leader_broker(topic, part_id);
+            if (cfd <= 0) {
+                usleep(FOLLOW_RETRY_BACKOFF * 1000);
+                continue;
+            }
+        }
+        // the broker holds the request until min_bytes arrived or max_wait expired,
+        // so there is no need to sleep between polls.
+        r = fetch_on_conn(cfd, topic, part_id, offset, fetch_size);
+        if (!r || r->topic_count <= 0 || r->t_infos[0].part_count <= 0) {
+            logger(DEBUG, "follow fetch failed, reconnect to leader.");
+            dealloc_response(r, FETCH_KEY);
+            close(cfd);
+            cfd = -1;
+            continue;
+        }
+
+        p_info = (struct fetch_part_info *)r->t_infos[0].p_infos;
+        err_code = p_info->err_code;
+        msg_set = p_info->msg_set;
+        if (err_code == 1) { // offset out of range, continue from the log end
+            logger(WARN, "offset %lld out of range, jump to the newest offset.", (long long)offset);
+            offset = get_newest_offset(topic, part_id) + 1;
+        } else if (err_code != 0) {
+            // leader may be moved, drop the topic metadata and reconnect
+            logger(WARN, "follow fetch error, err_code: %d.", err_code);
+            delete_topic_metadata_from_cache(get_metacache(), topic);
+            close(cfd);
+            cfd = -1;
+            usleep(FOLLOW_RETRY_BACKOFF * 1000);
+        } else if (msg_set->used > 0) {
+            dump_fetch_response(r);
+            offset = msg_set->msgs[msg_set->used - 1].offset + 1;
+        } else if (p_info->total_bytes > 0 && fetch_size < FOLLOW_MAX_FETCH_SIZE) {
+            // the next message is larger than fetch size
+            fetch_size *= 2;
+            logger(DEBUG, "message is too large, increase fetch size to %d.", fetch_size);
+        }
+        dealloc_response(r, FETCH_KEY);
+    }
+
+    if (cfd > 0) close(cfd);
+    return K_OK;
+}
@@ -20,10 +20,21 @@ typedef enum {
     HEARTBEAT_KEY
 } RequestId;
 
+struct fetch_target {
+    char *topic;
+    int part_id; // -1 means all partitions of the topic
+    int64_t offset; // -1 means the newest offset
+    int leader_id;
+};
+
 void dump_metadata(const char *topics);
 void dump_topic_list();
 struct metadata_response *send_metadata_request(const char *topics);
 struct response *send_offsets_request(const char *topic, int part_id, int64_t timestamp, int max_num_offsets); 
 struct response *send_fetch_request(const char *topic, int part_id, int64_t offset, int fetch_size);
+struct response **send_multi_fetch_request(struct fetch_target *targets, int count,
+        int fetch_size, int *resp_count);
+int follow_fetch(const char *topic, int part_id, int64_t offset, int fetch_size);
+void stop_follow_fetch();
 struct response *send_produce_request(const char *topic, int part_id, const char *key, const char *value);
 #endif
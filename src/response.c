@@ -17,7 +17,8 @@ struct buffer *wait_response(int cfd) {
     int rbytes = 0, rc, r, remain, resp_size;
     struct buffer *response;
 
-    rc = wait_socket_data(cfd, 3000, CR_READ);
+    // fetch request may be held by broker until max_wait expired
+    rc = wait_socket_data(cfd, 3000 + get_conf()->max_wait, CR_READ);
     if (rc <= 0) { // timeout or error
        logger(DEBUG, "wait response error, as %s!", strerror(errno));
         return NULL;
@@ -31,7 +32,6 @@ struct buffer *wait_response(int cfd) {
         if (r <= 0) {
             if (r == -1 &&
                    (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)) continue;
-            if (r == 0) close(cfd);
             logger(DEBUG, "wait response error, as %s!", strerror(errno));
             goto err_cleanup;
         }
@@ -46,7 +46,6 @@ struct buffer *wait_response(int cfd) {
         if (r <= 0) {
             if (r == -1 &&
                    (errno == EAGAIN || errno == EINTR || errno == EWOULDBLOCK)) continue;
-            if (r == 0) close(cfd);
             logger(DEBUG, "wait response error, as %s!", strerror(errno));
             goto err_cleanup;
         }
@@ -157,15 +156,15 @@ void dealloc_response(struct response *r, int type) {
     for (i = 0; i < r->topic_count; i++) {
         t_info = &r->t_infos[i];
         if (t_info->name) free(t_info->name);
-        if (!t_info->p_infos) break;
+        if (!t_info->p_infos) continue;
 
         for (j = 0; j < t_info->part_count; j++) {
             if (type == FETCH_KEY) {
-                p_info = &t_info->p_infos[j];
+                p_info = &TYPE_CONVERT(struct fetch_part_info*, t_info->p_infos)[j];
                 dealloc_messageset(p_info->msg_set);
             } else if (type == OFFSET_KEY) {
                 struct offsets_part_info *p_info;
-                p_info = &t_info->p_infos[j];
+                p_info = &TYPE_CONVERT(struct offsets_part_info*, t_info->p_infos)[j];
                 free(p_info->offsets);
             }
         }
@@ -241,8 +240,9 @@ struct response *parse_response(struct buffer *resp_buf, int type) {
         r->t_infos[i].name = read_short_string_buffer(resp_buf);
         r->t_infos[i].part_count = read_int32_buffer(resp_buf);
         if (r->t_infos[i].part_count <= 0) {
+            r->t_infos[i].part_count = 0;
             r->t_infos[i].p_infos = NULL;
-            return r;
+            continue;
         }
         switch(type) {
             case PRODUCE_KEY:
@@ -274,7 +274,7 @@ void dump_offsets_response(struct response *r) {
         t_info = &r->t_infos[i];
         printf("{ topic: %s, partitions: \n\t[\n", t_info->name);
         for (j = 0; j < t_info->part_count; j++) {
-            p_info = &r->t_infos[i].p_infos[j]; 
+            p_info = &TYPE_CONVERT(struct offsets_part_info*, r->t_infos[i].p_infos)[j];
             printf("\t\t{ part_id:%d, err_code:%d, offsets: [", 
                     p_info->part_id, p_info->err_code);
             for (k = 0; k < p_info->offset_count; k++) {
@@ -302,7 +302,7 @@ void dump_produce_response(struct response *r) {
     for (i = 0; i < r->topic_count; i++) {
         printf("\t{ name :%s, partitions: [\n", r->t_infos[i].name);
         for (j = 0; j <  r->t_infos[i].part_count; j++) {
-            p_info =  &r->t_infos[i].p_infos[j];
+            p_info = &TYPE_CONVERT(struct produce_part_info*, r->t_infos[i].p_infos)[j];
             printf("\t\t{part_id: %d, err_code: %d, offset: %lld},\n",
               p_info->part_id, p_info->err_code, p_info->offset);
         }
@@ -324,7 +324,7 @@ void dump_fetch_response(struct response *r) {
     for (i = 0; i < r->topic_count; i++) {
         printf("\t{ name :%s, partitions: [\n", r->t_infos[i].name);
         for (j = 0; j <  r->t_infos[i].part_count; j++) {
-            p_info =  &r->t_infos[i].p_infos[j];
+            p_info = &TYPE_CONVERT(struct fetch_part_info*, r->t_infos[i].p_infos)[j];
             printf("\t\t{part_id: %d, err_code: %d, highwater: %lld},\n",
               p_info->part_id, p_info->err_code, p_info->hw);
             for (k = 0; k < p_info->msg_set->used; k++) {